@@ -14,6 +14,15 @@
 #include <functional>
 #include <cmath>
 #include <algorithm>
+#ifdef PATHFINDING_PROFILING
+#include <chrono>
+#endif
+#ifdef PATHFINDING_RECORDING
+#include <cstdint>
+#include <ostream>
+#include <iomanip>
+#include <limits>
+#endif
 
 namespace pathfinding {
     // Structure representing a 2D point.
@@ -37,9 +46,10 @@ namespace pathfinding {
             
         }
         
-        Node operator=(const Node& other) {
+        Node& operator=(const Node& other) {
             this->x = other.x;
             this->y = other.y;
+            return *this;
         }
 
         bool operator==(const Node& other) const {
@@ -76,11 +86,13 @@ namespace pathfinding {
         Grid(Grid&& move) : data(std::move(move.data)) {
             
         }
-        Grid operator=(const Grid& copy) {
+        Grid& operator=(const Grid& copy) {
             this->data = copy.data;
+            return *this;
         }
-        Grid operator=(Grid&& move) {
+        Grid& operator=(Grid&& move) {
             this->data = std::move(move.data);
+            return *this;
         }
 
         // returns the begin of the y-Rows
@@ -158,6 +170,87 @@ namespace pathfinding {
         }
     };
 
+#ifdef PATHFINDING_PROFILING // These add timing overhead and should only be enabled for profiling
+// lets code built against several versions of this header check whether Pathfinder::getProfile exists
+#define PATHFINDING_HAS_PROFILE
+    // Timing breakdown of the calls to Pathfinder::find since the last reset.
+    // A call on a grid of a different size than the previous one resets the whole profile first,
+    // so the profile never mixes data from grids of different sizes.
+    // All durations are in nanoseconds.
+    struct Profile {
+        long long total = 0;     // whole find call
+        long long heap = 0;      // selecting and removing the lowest f-cost node
+        long long neighbors = 0; // generating the neighbors of a node
+        long long cost = 0;      // movement cost function and heuristic evaluation
+        size_t expansions = 0;   // nodes taken from the open list
+        Grid<unsigned> expansionCounts; // how often each node was taken from the open list
+
+        void reset() {
+            *this = Profile();
+        }
+    };
+#endif
+
+#ifdef PATHFINDING_RECORDING // Logs every query for replaying it later
+// lets code built against several versions of this header check whether Pathfinder::setQueryCallback exists
+#define PATHFINDING_HAS_RECORDING
+    // FNV-1a hash over the grid size and the std::hash of every value.
+    // Identifies the grid a recorded query was run on.
+    template<typename T>
+    uint64_t hashGrid(const Grid<T>& grid) {
+        uint64_t hash = 14695981039346656037ull;
+        const auto add = [&](uint64_t value, int bytes) {
+            for (int i = 0; i < bytes; i++) {
+                hash ^= (value >> (i * 8)) & 0xff;
+                hash *= 1099511628211ull;
+            }
+        };
+
+        const Node size = grid.getSize();
+        add(static_cast<uint32_t>(size.x), 4);
+        add(static_cast<uint32_t>(size.y), 4);
+        for (const auto& yRow : grid) {
+            for (const auto& element : yRow) {
+                add(static_cast<uint64_t>(std::hash<T>()(element)), 8);
+            }
+        }
+        return hash;
+    }
+
+    // A single call to Pathfinder::find, passed to the query callback after the call.
+    // move is only valid during the callback.
+    struct QueryRecord {
+        uint64_t gridHash;
+        Node start, goal;
+        const Grid<double>& move;
+        std::string mode; // tag for the movement cost function, set with Pathfinder::setQueryMode
+        int result;
+        size_t pathLength;
+    };
+
+    // Writes a record as "<grid hash> <startX> <startY> <goalX> <goalY> <move width> <move height> <move values...> <mode> <result> <path length>".
+    // The move values are written with full precision, so that a replay uses exactly the same costs.
+    inline std::ostream& operator<<(std::ostream& out, const QueryRecord& record) {
+        const std::ios::fmtflags flags = out.flags();
+        const std::streamsize precision = out.precision();
+        const Node moveSize = record.move.getSize();
+
+        out << std::hex << record.gridHash << std::dec << " "
+            << record.start.x << " " << record.start.y << " " << record.goal.x << " " << record.goal.y << " "
+            << moveSize.x << " " << moveSize.y << std::setprecision(std::numeric_limits<double>::max_digits10);
+        for (const auto& yRow : record.move) {
+            for (const auto& element : yRow) {
+                out << " " << element;
+            }
+        }
+        out << " " << record.mode << " " << record.result << " " << record.pathLength;
+
+        out.flags(flags);
+        out.precision(precision);
+        return out;
+    }
+#endif
+
     // A template class for the a*-pathfinding algorithms.
     template<typename T>
     class Pathfinder {
@@ -169,6 +262,30 @@ namespace pathfinding {
         std::function<void(const Node& node)> onPoppedNodeCallback = [&](const Node& node){}; // default = empty function
         // this function gets called when a new node is added to the output path
         std::function<void(const Node& node)> onPathAddedCallback = [&](const Node& node){}; // default = emtpy function
+#endif
+#ifdef PATHFINDING_PROFILING
+        // find is const, but still has to record its timings
+        // this makes find unsafe to call concurrently on the same Pathfinder in profiling builds
+        mutable Profile profile;
+
+        // Adds the time since it was constructed to a Profile counter when it goes out of scope.
+        class ScopedTimer {
+            long long& target;
+            std::chrono::steady_clock::time_point start;
+        public:
+            ScopedTimer(long long& target) : target(target), start(std::chrono::steady_clock::now()) {
+
+            }
+            ~ScopedTimer() {
+                target += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            }
+        };
+#endif
+#ifdef PATHFINDING_RECORDING
+        // this function gets called after every find call
+        std::function<void(const QueryRecord& record)> onQueryCallback = [&](const QueryRecord& record){}; // default = empty function
+        // written into every QueryRecord, so that a replay can pick the same movement cost function
+        std::string queryMode = "default";
 #endif
     public:
         // constructors
@@ -231,6 +348,15 @@ namespace pathfinding {
             this->movementCostFunction = movementCostFunction;
         }
 
+#ifdef PATHFINDING_RECORDING
+        void setQueryCallback(std::function<void(const QueryRecord& record)> onQueryCallback) {
+            this->onQueryCallback = onQueryCallback;
+        }
+        void setQueryMode(const std::string& queryMode) {
+            this->queryMode = queryMode;
+        }
+#endif
+
 #ifdef PATHFINDING_CALLBACKS
         void setPoppedNodeCallback(std::function<void(const Node& node)> onPoppedNodeCallback) {
             this->onPoppedNodeCallback = onPoppedNodeCallback;
@@ -257,6 +383,24 @@ namespace pathfinding {
         }
 #endif
 
+#ifdef PATHFINDING_RECORDING
+        const std::function<void(const QueryRecord& record)>& getQueryCallback() const {
+            return onQueryCallback;
+        }
+        const std::string& getQueryMode() const {
+            return queryMode;
+        }
+#endif
+
+#ifdef PATHFINDING_PROFILING
+        const Profile& getProfile() const {
+            return profile;
+        }
+        void resetProfile() {
+            profile.reset();
+        }
+#endif
+
     private:
         struct PathNode : public Node {
             double g, h, f;
@@ -342,6 +486,19 @@ namespace pathfinding {
             {   1,  -1,   1 },
             { 1.4,   1, 1.4 }
         })) const {
+            const int result = search(startNode, endNode, path, move);
+#ifdef PATHFINDING_RECORDING
+            onQueryCallback(QueryRecord{ hashGrid(grid), startNode, endNode, move, queryMode, result, path.size() });
+#endif
+            return result;
+        }
+
+    private:
+        // The a*-search behind find
+        int search(Node startNode, Node endNode, std::vector<Node>& path, const Grid<double>& move) const {
+#ifdef PATHFINDING_PROFILING
+            ScopedTimer totalTimer(profile.total);
+#endif
             // clear input path
             path.clear();
 
@@ -357,6 +514,14 @@ namespace pathfinding {
             }
             Grid<PathNode> pathnodes(nodes);
 
+#ifdef PATHFINDING_PROFILING
+            // start a new profile if the grid size has changed since the last call
+            if (!(profile.expansionCounts.getSize() == size)) {
+                profile.reset();
+                profile.expansionCounts = Grid<unsigned>(size);
+            }
+#endif
+
             // Initialize nodeList
             std::vector<PathNode*> nodeList;
             for (int x = 0; x < size.x; x++) {
@@ -378,7 +543,15 @@ namespace pathfinding {
             start->parent = nullptr;
 
             while (nodeList.size()) {
+#ifdef PATHFINDING_PROFILING
+                PathNode* current;
+                {
+                    ScopedTimer heapTimer(profile.heap);
+                    current = getAndRemoveTop(nodeList);
+                }
+#else
                 PathNode* current = getAndRemoveTop(nodeList);
+#endif
 
                 // unpopped nodes have g < 0
                 // if the top node is unpopped, no correct solution exists
@@ -386,6 +559,11 @@ namespace pathfinding {
                     return 1;
                 }
 
+#ifdef PATHFINDING_PROFILING
+                profile.expansions++;
+                profile.expansionCounts.at(*current)++;
+#endif
+
                 // check if end is reached
                 if (Node(*current) == Node(*end)) {
                     reconstructPath(current, path);
@@ -393,13 +571,31 @@ namespace pathfinding {
                 }
 
                 // Explore neighbors
-                for (PathNode* neighbor : getNeighbors(current, pathnodes, move)) {
+#ifdef PATHFINDING_PROFILING
+                std::vector<PathNode*> neighbors;
+                {
+                    ScopedTimer neighborsTimer(profile.neighbors);
+                    neighbors = getNeighbors(current, pathnodes, move);
+                }
+#else
+                const std::vector<PathNode*> neighbors = getNeighbors(current, pathnodes, move);
+#endif
+                for (PathNode* neighbor : neighbors) {
                     // pop node
                     // move has to be flipped, because the algorithm works backwards
+#ifdef PATHFINDING_PROFILING
+                    double rawMovementCost;
+                    {
+                        ScopedTimer costTimer(profile.cost);
+                        rawMovementCost = movementCostFunction(grid[static_cast<Node>(*current)], grid[static_cast<Node>(*neighbor)]) * 
+                            move.at(move.getSize().x - (neighbor->x - current->x + 2), move.getSize().y - (neighbor->y - current->y + 2));
+                    }
+#else
                     double rawMovementCost = movementCostFunction(grid[static_cast<Node>(*current)], grid[static_cast<Node>(*neighbor)]) * 
                         move.at(move.getSize().x - (neighbor->x - current->x + 2), move.getSize().y - (neighbor->y - current->y + 2));
                         // previos (unflipped move):
                         //move.at(neighbor->x - current->x + 1, neighbor->y - current->y + 1);
+#endif
                     double tentativeG = current->g + rawMovementCost;
 
                     // g cost < 0 means intraversable node
@@ -414,7 +610,14 @@ namespace pathfinding {
                     if (tentativeG < neighbor->g || neighbor->g < 0) {
                         neighbor->parent = current;
                         neighbor->g = tentativeG;
+#ifdef PATHFINDING_PROFILING
+                        {
+                            ScopedTimer costTimer(profile.cost);
+                            neighbor->h = hCost(*neighbor, *end);
+                        }
+#else
                         neighbor->h = hCost(*neighbor, *end);
+#endif
                         neighbor->f = neighbor->g + neighbor->h;
                     }
                 }
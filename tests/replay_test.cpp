@@ -0,0 +1,369 @@
+// This is a replay and profiling tool for the pathfinding.hpp library
+// It records pathfinding queries into a query log and replays them deterministically,
+// writing an expansion heatmap per query and a timing breakdown in the folded stack format
+// (which can be turned into a flame graph with e.g. flamegraph.pl)
+// Replay reports every query whose result or path length differs from the recording.
+// This uses lodepng from (https://github.com/lvandeve/lodepng) to load and save png images (see visual_test.cpp)
+//
+// Usage:
+//   replay_test record <log> <grid file> [startX startY goalX goalY [stencil [mode]]]
+//   replay_test replay <log> <output directory>
+//
+// Applications record their own queries with the PATHFINDING_RECORDING hook of the header: every log line is
+// the grid file followed by a pathfinding::QueryRecord (see README). The record command is a shortcut that uses the same hook.
+// Grid files are either maze images (.png, loaded like in visual_test.cpp) or text grids of ints
+// ("<width> <height>" followed by the values row by row). Only int grids can be replayed, and the mode
+// of a query has to name one of the movement cost functions in getMovementCostFunction.
+//
+// To compare engine versions build this file once per version, e.g. with
+// -DPATHFINDING_HEADER='"old/pathfinding.hpp"', and replay the same log with each build.
+// Versions without Pathfinder::getProfile only report the wall-clock time of each find call.
+// The queries are built without Node and Grid assignments, because these are broken in older versions.
+
+// include the lodepng library
+#include "lodepng.h" // excluded from git
+
+#define PATHFINDING_PROFILING // include the timing breakdown
+#define PATHFINDING_RECORDING // include the query callback
+#ifndef PATHFINDING_HEADER
+#define PATHFINDING_HEADER "../pathfinding.hpp"
+#endif
+#include PATHFINDING_HEADER
+
+#include <vector>
+#include <map>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdint>
+#include <chrono>
+
+namespace pf = pathfinding;
+
+// One line of the query log (the grid file followed by a pathfinding::QueryRecord):
+// <grid file> <grid hash> <startX> <startY> <goalX> <goalY> <stencil width> <stencil height> <stencil values...> <mode> <result> <path length>
+// Lines starting with '#' are comments.
+struct Query {
+    std::string gridFile;
+    uint64_t gridHash = 0;
+    pf::Node start, goal;
+    pf::Grid<double> stencil;
+    std::string mode;
+    // outcome of the recorded run
+    int result = 0;
+    size_t pathLength = 0;
+};
+
+// movement stencils that can be selected by name when recording (record handles "default", the default movement of find)
+pf::Grid<double> getStencil(const std::string& name) {
+    if (name == "orthogonal") {
+        return pf::Grid<double>({
+            { -1,  1, -1 },
+            {  1, -1,  1 },
+            { -1,  1, -1 }
+        });
+    }
+    if (name == "diagonal") {
+        return pf::Grid<double>({
+            { 1.4,   1, 1.4 },
+            {   1,  -1,   1 },
+            { 1.4,   1, 1.4 }
+        });
+    }
+    throw std::invalid_argument("Unknown stencil: " + name);
+}
+
+// movement cost functions, the mode of a query selects one of these
+std::function<double(int, int)> getMovementCostFunction(const std::string& mode) {
+    if (mode == "default") {
+        return [](int, int to) -> double {
+            return to < 0 ? -1 : to + 1;
+        };
+    }
+    if (mode == "unit") {
+        return [](int, int to) -> double {
+            return to < 0 ? -1 : 1;
+        };
+    }
+    throw std::invalid_argument("Unknown mode: " + mode);
+}
+
+// used to detect a changed grid file on replay
+#ifdef PATHFINDING_HAS_RECORDING
+using pf::hashGrid;
+#else
+// copy of pathfinding::hashGrid for headers without it, both have to produce the same hash
+uint64_t hashGrid(const pf::Grid<int>& grid) {
+    uint64_t hash = 14695981039346656037ull;
+    const auto add = [&](uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) {
+            hash ^= (value >> (i * 8)) & 0xff;
+            hash *= 1099511628211ull;
+        }
+    };
+
+    const pf::Node size = grid.getSize();
+    add(static_cast<uint32_t>(size.x), 4);
+    add(static_cast<uint32_t>(size.y), 4);
+    for (const auto& yRow : grid) {
+        for (const auto& element : yRow) {
+            add(static_cast<uint64_t>(std::hash<int>()(element)), 8);
+        }
+    }
+    return hash;
+}
+#endif
+
+// loads a text grid: "<width> <height>" followed by the values row by row
+pf::Grid<int> loadTextGrid(const std::string& file) {
+    std::ifstream in(file);
+    if (!in) throw std::runtime_error("Could not open grid file: " + file);
+
+    int width = 0, height = 0;
+    in >> width >> height;
+    if (!in || width < 0 || height < 0) throw std::runtime_error("Malformed grid file: " + file);
+
+    std::vector<std::vector<int>> data(height, std::vector<int>(width));
+    for (auto& yRow : data) {
+        for (auto& element : yRow) {
+            in >> element;
+        }
+    }
+    if (!in) throw std::runtime_error("Malformed grid file: " + file);
+
+    return pf::Grid<int>(data);
+}
+
+// loads a maze image the same way as visual_test.cpp: black pixels are walls (-1), everything else is 0
+// any other file is loaded as a text grid
+pf::Grid<int> loadGrid(const std::string& file) {
+    if (file.size() < 4 || file.compare(file.size() - 4, 4, ".png") != 0) {
+        return loadTextGrid(file);
+    }
+
+    std::vector<unsigned char> image;
+    unsigned width, height;
+
+    unsigned error = lodepng::decode(image, width, height, file);
+    if (error) throw std::runtime_error("decoder error " + std::to_string(error) + ": " + lodepng_error_text(error));
+
+    pf::Grid<int> grid(width, height);
+
+    std::size_t counter = 0;
+    for (auto& yRow : grid) {
+        for (auto& element : yRow) {
+            element = ((image.at(counter + 0) + image.at(counter + 1) + image.at(counter + 2)) == 0) ? -1 : 0;
+            counter += 4;
+        }
+    }
+    return grid;
+}
+
+Query parseQuery(const std::string& line) {
+    std::istringstream in(line);
+    std::string gridFile, mode;
+    uint64_t gridHash = 0;
+    int startX = 0, startY = 0, goalX = 0, goalY = 0, stencilX = 0, stencilY = 0, result = 0;
+    size_t pathLength = 0;
+
+    in >> gridFile >> std::hex >> gridHash >> std::dec
+        >> startX >> startY >> goalX >> goalY >> stencilX >> stencilY;
+    if (!in || stencilX <= 0 || stencilY <= 0) throw std::runtime_error("Malformed query: " + line);
+
+    std::vector<std::vector<double>> stencil(stencilY, std::vector<double>(stencilX));
+    for (auto& yRow : stencil) {
+        for (auto& element : yRow) {
+            in >> element;
+        }
+    }
+    in >> mode >> result >> pathLength;
+    if (!in) throw std::runtime_error("Malformed query: " + line);
+
+    return Query{ gridFile, gridHash, pf::Node(startX, startY), pf::Node(goalX, goalY), pf::Grid<double>(stencil), mode, result, pathLength };
+}
+
+std::vector<Query> readLog(const std::string& file) {
+    std::ifstream in(file);
+    if (!in) throw std::runtime_error("Could not open query log: " + file);
+
+    std::vector<Query> queries;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        queries.push_back(parseQuery(line));
+    }
+    return queries;
+}
+
+#ifdef PATHFINDING_HAS_RECORDING
+// runs a query and appends it to the log through the query callback of the Pathfinder
+// the stencil "default" runs the query with the default movement of find
+int record(const std::string& log, const std::string& gridFile, const pf::Node& start, const pf::Node& goal, const std::string& stencil, const std::string& mode) {
+    const pf::Grid<int> grid = loadGrid(gridFile);
+
+    std::ofstream out(log, std::ios::app);
+    if (!out) throw std::runtime_error("Could not open query log: " + log);
+
+    pf::Pathfinder<int> pathfinder(grid, getMovementCostFunction(mode));
+    pathfinder.setQueryMode(mode);
+    pathfinder.setQueryCallback([&](const pf::QueryRecord& query) {
+        out << gridFile << " " << query << "\n";
+        std::cout << "Recorded: " << gridFile << " " << query << "\n";
+    });
+
+    std::vector<pf::Node> path;
+    const int result = stencil == "default" ? pathfinder.find(start, goal, path) : pathfinder.find(start, goal, path, getStencil(stencil));
+
+    std::cout << "Result: " << result << ", Path length: " << path.size() << "\n";
+    return 0;
+}
+#endif
+
+#ifdef PATHFINDING_HAS_PROFILE
+// writes the grid as an image: walls black, unexpanded white, expanded nodes from yellow (few expansions) to red (many expansions), path green
+void saveHeatmap(const std::string& file, const pf::Grid<int>& grid, const pf::Grid<unsigned>& expansions, const std::vector<pf::Node>& path) {
+    const pf::Node size = grid.getSize();
+
+    unsigned maxExpansions = 0;
+    for (const auto& yRow : expansions) {
+        for (const auto& element : yRow) {
+            maxExpansions = std::max(maxExpansions, element);
+        }
+    }
+
+    std::vector<unsigned char> image(size.x * size.y * 4, 255);
+    for (int y = 0; y < size.y; y++) {
+        for (int x = 0; x < size.x; x++) {
+            unsigned char* pixel = &image[y * size.x * 4 + x * 4];
+            if (grid.at(x, y) < 0) {
+                pixel[0] = pixel[1] = pixel[2] = 0;
+            }
+            else if (expansions.at(x, y) > 0) {
+                const double t = static_cast<double>(expansions.at(x, y)) / maxExpansions;
+                pixel[1] = static_cast<unsigned char>(255 * (1 - t));
+                pixel[2] = 0;
+            }
+        }
+    }
+    for (const auto& node : path) {
+        unsigned char* pixel = &image[node.y * size.x * 4 + node.x * 4];
+        pixel[0] = 0;
+        pixel[1] = 200;
+        pixel[2] = 0;
+    }
+
+    unsigned error = lodepng::encode(file, image, size.x, size.y);
+    if (error) std::cout << "encoder error " << error << ": " << lodepng_error_text(error) << std::endl;
+}
+#endif
+
+// replays every query of the log, writes query<N>_heatmap.png and profile.folded into the output directory
+// (without Pathfinder::getProfile there is no heatmap and profile.folded only contains the whole find call)
+int replay(const std::string& log, const std::string& outputDirectory) {
+    const std::vector<Query> queries = readLog(log);
+    std::map<std::string, pf::Grid<int>> grids; // each grid file is only loaded once
+    size_t diverged = 0;
+
+    std::ofstream folded(outputDirectory + "/profile.folded");
+    if (!folded) throw std::runtime_error("Could not open output file: " + outputDirectory + "/profile.folded");
+
+    std::cout << "query\tresult\tpath\texpansions\ttotal_us\theap_us\tneighbors_us\tcost_us\n";
+
+    for (size_t i = 0; i < queries.size(); i++) {
+        const Query& query = queries[i];
+
+        if (grids.find(query.gridFile) == grids.end()) {
+            grids.emplace(query.gridFile, loadGrid(query.gridFile));
+        }
+        const pf::Grid<int>& grid = grids.at(query.gridFile);
+
+        // the same query on a different grid would not be a replay
+        if (hashGrid(grid) != query.gridHash) {
+            throw std::runtime_error("Grid hash mismatch for query " + std::to_string(i) + ": " + query.gridFile + " has changed since recording");
+        }
+
+        pf::Pathfinder<int> pathfinder(grid, getMovementCostFunction(query.mode));
+
+        // the wall-clock time is measured here so that it can be compared between all versions of the header
+        std::vector<pf::Node> path;
+        const auto start = std::chrono::steady_clock::now();
+        const int result = pathfinder.find(query.start, query.goal, path, query.stencil);
+        const long long total = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+        const std::string stack = "replay;query" + std::to_string(i) + ";find";
+#ifdef PATHFINDING_HAS_PROFILE
+        const pf::Profile& profile = pathfinder.getProfile();
+        folded << stack << ";getAndRemoveTop " << profile.heap << "\n";
+        folded << stack << ";getNeighbors " << profile.neighbors << "\n";
+        folded << stack << ";movementCost " << profile.cost << "\n";
+        // time spent in find itself (setup, bookkeeping and path reconstruction)
+        folded << stack << " " << std::max(0ll, total - profile.heap - profile.neighbors - profile.cost) << "\n";
+
+        saveHeatmap(outputDirectory + "/query" + std::to_string(i) + "_heatmap.png", grid, profile.expansionCounts, path);
+
+        std::cout << i << "\t" << result << "\t" << path.size() << "\t" << profile.expansions << "\t"
+            << total / 1000 << "\t" << profile.heap / 1000 << "\t"
+            << profile.neighbors / 1000 << "\t" << profile.cost / 1000 << "\n";
+#else
+        folded << stack << " " << total << "\n";
+
+        std::cout << i << "\t" << result << "\t" << path.size() << "\t-\t" << total / 1000 << "\t-\t-\t-\n";
+#endif
+
+        if (result != query.result || path.size() != query.pathLength) {
+            std::cout << "Query " << i << " diverged: recorded result " << query.result << ", path length " << query.pathLength
+                << "; replayed result " << result << ", path length " << path.size() << "\n";
+            diverged++;
+        }
+    }
+
+    std::cout << diverged << " of " << queries.size() << " queries diverged from the recording\n";
+    return diverged ? 2 : 0;
+}
+
+int main(int argc, char **argv) {
+    const std::string usage =
+        "Usage:\n"
+        "  replay_test record <log> <grid file> [startX startY goalX goalY [stencil [mode]]]\n"
+        "  replay_test replay <log> <output directory>\n"
+        "start, goal: top left to bottom right if omitted\n"
+        "stencil: default (the default movement of find), orthogonal, diagonal\n"
+        "mode: default (default), unit\n";
+
+    // record takes either no coordinates or all four
+    const std::string command = argc > 1 ? argv[1] : "";
+    const bool validRecord = command == "record" && (argc == 4 || (argc >= 8 && argc <= 10));
+    const bool validReplay = command == "replay" && argc == 4;
+    if (!validRecord && !validReplay) {
+        std::cout << usage;
+        return 1;
+    }
+
+    try {
+        if (validRecord) {
+#ifdef PATHFINDING_HAS_RECORDING
+            const std::string gridFile = argv[3];
+            const std::string stencil = argc > 8 ? argv[8] : "default";
+            const std::string mode = argc > 9 ? argv[9] : "default";
+            // fail before running on an unknown stencil or mode
+            if (stencil != "default") getStencil(stencil);
+            getMovementCostFunction(mode);
+
+            const pf::Node size = argc > 7 ? pf::Node() : loadGrid(gridFile).getSize();
+            const pf::Node start = argc > 7 ? pf::Node(std::stoi(argv[4]), std::stoi(argv[5])) : pf::Node(0, 0);
+            const pf::Node goal = argc > 7 ? pf::Node(std::stoi(argv[6]), std::stoi(argv[7])) : pf::Node(size.x - 1, size.y - 1);
+
+            return record(argv[2], gridFile, start, goal, stencil, mode);
+#else
+            std::cout << "Error: recording needs a version of pathfinding.hpp with PATHFINDING_RECORDING\n";
+            return 1;
+#endif
+        }
+        return replay(argv[2], argv[3]);
+    }
+    catch (std::exception& err) {
+        std::cout << "Error: " << err.what() << "\n";
+        return 1;
+    }
+}